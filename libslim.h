@@ -23,17 +23,56 @@
 #include <string.h>
 
 
+#ifndef LIBSLIM_TILE_SHIFT
+# define LIBSLIM_TILE_SHIFT 3
+#endif
+#define LIBSLIM_TILE_SIZE ((size_t)1 << LIBSLIM_TILE_SHIFT)
+#define LIBSLIM_TILE_MASK (LIBSLIM_TILE_SIZE - 1)
+#define LIBSLIM_TILE_AREA (LIBSLIM_TILE_SIZE << LIBSLIM_TILE_SHIFT)
+
+#ifndef LIBSLIM_MAX_DIRTY_RECTS
+# define LIBSLIM_MAX_DIRTY_RECTS 16
+#endif
+
+
+struct libslim_rect {
+	size_t left;
+	size_t top;
+	size_t width;
+	size_t height;
+};
+
+struct libslim_dirty_region {
+	size_t count;
+	struct libslim_rect rects[LIBSLIM_MAX_DIRTY_RECTS]; /* Never overlap */
+};
+
 struct libslim_image_meta {
 	size_t width;
 	size_t height;
 	size_t hblank;
+	struct libslim_dirty_region *dirty; /* NULL if the entire image is dirty */
+};
+
+struct libslim_tiled_image_meta {
+	size_t width;
+	size_t height;
+	size_t left; /* Number of padding columns before the first column */
+	size_t top; /* Number of padding rows before the first row */
+	size_t tiles_across;
+	size_t tiles_down;
+	int zorder; /* Whether pixels in each tile are stored in Morton order */
 };
 
-#define LIBSLIM_DECLARE_FORMAT(SUFFIX, PIXEL)\
-	struct libslim_pixel_##SUFFIX PIXEL;\
+#define LIBSLIM_DECLARE_FORMAT(SUFFIX, ...)\
+	struct libslim_pixel_##SUFFIX __VA_ARGS__;\
 	struct libslim_image_##SUFFIX {\
 		struct libslim_image_meta meta;\
 		struct libslim_pixel_##SUFFIX *data;\
+	};\
+	struct libslim_tiled_image_##SUFFIX {\
+		struct libslim_tiled_image_meta meta;\
+		struct libslim_pixel_##SUFFIX *data;\
 	}
 
 LIBSLIM_DECLARE_FORMAT(xyza_f, { float x, y, z, a; });
@@ -54,18 +93,21 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 
 
 
-/* Replace an entire row, of an image, with a single colour */
-#define libslim_set_colour_row(OUT, COLOUR)\
+/* Replace an entire row, of an image, with a single colour;
+ * use libslim_set_colour_row instead, which selects a kernel
+ * specialised for the format when there is one */
+#define libslim_set_colour_row_generic__(OUT, COLOUR)\
 	do {\
-		size_t x__, y__;\
+		size_t x__;\
 		size_t w__ = (OUT)->meta.width;\
 		for (x__ = 0; x__ < w__; x__++)\
 			(OUT)->data[x__] = *(COLOUR);\
 	} while (0)
 
 
-/* Replace an entire image with a single colour */
-#define libslim_set_colour(OUT, COLOUR)\
+/* Replace an entire image with a single colour; use
+ * libslim_set_colour instead */
+#define libslim_set_colour_generic__(OUT, COLOUR)\
 	do {\
 		size_t x__, y__;\
 		size_t h__ = (OUT)->meta.height;\
@@ -80,21 +122,21 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 	} while (0)
 
 
-/* Horizontally flip a row of an image */
-#define libslim_flop_row(OUT, IN)\
+/* Horizontally flip a row of an image; use libslim_flop_row instead */
+#define libslim_flop_row_generic__(OUT, IN)\
 	do {\
 		size_t i__;\
-		size_t n__ = (IN)->meta.width - 1;\
+		size_t n__ = (IN)->meta.width;\
 		for (i__ = 0; i__ < n__; i__++)\
-			(OUT)->data[n__ - i__] = (IN)->data[i__];\
+			(OUT)->data[n__ - 1 - i__] = (IN)->data[i__];\
 	} while (0)
 
 
-/* Horizontally flip an image */
-#define libslim_flop(OUT, IN)\
+/* Horizontally flip an image; use libslim_flop instead */
+#define libslim_flop_generic__(OUT, IN)\
 	do {\
 		size_t i__;\
-		size_t n__ = (IN)->meta.width - 1;\
+		size_t n__ = (IN)->meta.width;\
 		size_t h__ = (IN)->meta.height;\
 		void *in__ = (IN)->data;\
 		void *out__ = (OUT)->data;\
@@ -102,7 +144,7 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 		(OUT)->meta.height = (IN)->meta.height;\
 		while (h__--) {\
 			for (i__ = 0; i__ < n__; i__++)\
-				(OUT)->data[n__ - i__] = (IN)->data[i__];\
+				(OUT)->data[n__ - 1 - i__] = (IN)->data[i__];\
 			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
 			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
 		}\
@@ -111,32 +153,28 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 	} while (0)
 
 
-/* Vertically flip an image */
-#define libslim_flip(OUT, IN)\
+/* Vertically flip an image; use libslim_flip instead */
+#define libslim_flip_generic__(OUT, IN)\
 	do {\
 		size_t i__;\
-		size_t n__ = (IN)->meta.height - 1;\
+		size_t h__ = (IN)->meta.height;\
 		size_t w__ = (IN)->meta.width * sizeof(*(IN)->data);\
 		void *in__ = (IN)->data;\
-		void *out__ = (OUT)->data;\
 		(OUT)->meta.width = (IN)->meta.width;\
 		(OUT)->meta.height = (IN)->meta.height;\
-		(OUT)->data += n__ * ((OUT)->meta.width + (OUT)->meta.hblank);\
-		for (i__ = 0; i__ < n__; i__++) {\
-			memcpy((OUT)->data, (IN)->data, w__);\
+		for (i__ = 0; i__ < h__; i__++) {\
+			memcpy((OUT)->data + (h__ - 1 - i__) * ((OUT)->meta.width + (OUT)->meta.hblank), (IN)->data, w__);\
 			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
-			(OUT)->data -= (OUT)->meta.width + (OUT)->meta.hblank;\
 		}\
 		(IN)->data = in__;\
-		(OUT)->data = out__;\
 	} while (0)
 
 
-/* Transpose an image */
-#define libslim_transpose(OUT, IN)\
+/* Transpose an image; use libslim_transpose instead */
+#define libslim_transpose_generic__(OUT, IN)\
 	do {\
 		size_t x__, y__, i__;\
-		size_t rw__ = (OUT)->meta.width + (OUT)->meta.hblank;\
+		size_t rw__ = (IN)->meta.height + (OUT)->meta.hblank;\
 		size_t w__ = (IN)->meta.width;\
 		size_t h__ = (IN)->meta.height;\
 		void *in__ = (IN)->data;\
@@ -150,35 +188,80 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 			(OUT)->data += 1;\
 		}\
 		(IN)->data = in__;\
-		(OUT)->data = in__;\
+		(OUT)->data = out__;\
 	} while (0)
 
 
-/* Rotate an image 90 degrees clockwise */
-#define libslim_rotate_90(OUT, IN)\
+/* Rotate an image 90 degrees clockwise; use libslim_rotate_90 instead */
+#define libslim_rotate_90_generic__(OUT, IN)\
 	do {\
-		libslim_transpose((IN), (OUT));\
-		libslim_flop((IN), (OUT));\
+		size_t x__, y__, i__;\
+		size_t rw__ = (IN)->meta.height + (OUT)->meta.hblank;\
+		size_t w__ = (IN)->meta.width;\
+		size_t h__ = (IN)->meta.height;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.width = (IN)->meta.height;\
+		(OUT)->meta.height = (IN)->meta.width;\
+		(OUT)->data += h__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			(OUT)->data -= 1;\
+			for (x__ = i__ = 0; x__ < w__; x__++, i__ += rw__)\
+				(OUT)->data[i__] = (IN)->data[x__];\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
 	} while (0)
 
 
-/* Rotate an image 180 degrees */
-#define libslim_rotate_180(OUT, IN)\
+/* Rotate an image 180 degrees; use libslim_rotate_180 instead */
+#define libslim_rotate_180_generic__(OUT, IN)\
 	do {\
-		libslim_flip((IN), (OUT));\
-		libslim_flop((IN), (OUT));\
+		size_t x__, y__;\
+		size_t rw__ = (IN)->meta.width + (OUT)->meta.hblank;\
+		size_t w__ = (IN)->meta.width;\
+		size_t h__ = (IN)->meta.height;\
+		void *in__ = (IN)->data;\
+		(OUT)->meta.width = (IN)->meta.width;\
+		(OUT)->meta.height = (IN)->meta.height;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			for (x__ = 0; x__ < w__; x__++)\
+				(OUT)->data[(h__ - 1 - y__) * rw__ + (w__ - 1 - x__)] = (IN)->data[x__];\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
 	} while (0)
 
 
-/* Rotate an image 270 degrees clockwise */
-#define libslim_rotate_270(OUT, IN)\
+/* Rotate an image 270 degrees clockwise; use libslim_rotate_270 instead */
+#define libslim_rotate_270_generic__(OUT, IN)\
 	do {\
-		libslim_flop((IN), (OUT));\
-		libslim_transpose((IN), (OUT));\
+		size_t x__, y__, i__;\
+		size_t rw__ = (IN)->meta.height + (OUT)->meta.hblank;\
+		size_t w__ = (IN)->meta.width;\
+		size_t h__ = (IN)->meta.height;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.width = (IN)->meta.height;\
+		(OUT)->meta.height = (IN)->meta.width;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			for (x__ = 0, i__ = w__ * rw__; x__ < w__; x__++) {\
+				i__ -= rw__;\
+				(OUT)->data[i__] = (IN)->data[x__];\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += 1;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
 	} while (0)
 
 
-/* Swap channels in an image with 4 channels */
+/* Swap channels in an image with 4 channels; the images may be of
+ * different formats, in which case this also converts the precision
+ * of the channels, and the swap_channels macros for fewer channels
+ * can be used to drop channels */
 #define libslim_swap_channels_4(OUT, IN, IN_CH1, OUT_CH1, IN_CH2, OUT_CH2, IN_CH3, OUT_CH3, IN_CH4, OUT_CH4)\
 	do {\
 		size_t x__, y__;\
@@ -289,6 +372,49 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 	} while (0)
 
 
+/* Copy 3 channels from an image to an image of any format, and
+ * set the value of 1 other channel in all pixels, for example
+ * to add an alpha channel; the channels are converted to the
+ * precision of the output image */
+#define libslim_swap_channels_3_set_1_channel(OUT, IN, IN_CH1, OUT_CH1, IN_CH2, OUT_CH2, IN_CH3, OUT_CH3, COLOUR, CH)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			for (x__ = 0; x__ < w__; x__++) {\
+				(OUT)->data[x__].OUT_CH1 = (IN)->data[x__].IN_CH1;\
+				(OUT)->data[x__].OUT_CH2 = (IN)->data[x__].IN_CH2;\
+				(OUT)->data[x__].OUT_CH3 = (IN)->data[x__].IN_CH3;\
+				(OUT)->data[x__].CH = (COLOUR)->CH;\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Copy 3 channels from a row of an image to a row of an image of
+ * any format, and set the value of 1 other channel in all pixels */
+#define libslim_swap_channels_3_set_1_channel_row(OUT, IN, IN_CH1, OUT_CH1, IN_CH2, OUT_CH2, IN_CH3, OUT_CH3, COLOUR, CH)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		for (i__ = 0; i__ < n__; i__++) {\
+			(OUT)->data[i__].OUT_CH1 = (IN)->data[i__].IN_CH1;\
+			(OUT)->data[i__].OUT_CH2 = (IN)->data[i__].IN_CH2;\
+			(OUT)->data[i__].OUT_CH3 = (IN)->data[i__].IN_CH3;\
+			(OUT)->data[i__].CH = (COLOUR)->CH;\
+		}\
+	} while (0)
+
+
 /* Set the values of 3 channels in all pixels in an image */
 #define libslim_set_3_channels(OUT, IN, COLOUR, CH1, CH2, CH3)\
 	do {\
@@ -400,8 +526,8 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 	} while (0)
 
 
-/* Crop an image */
-#define libslim_crop(OUT, IN, LEFT, TOP, WIDTH, HEIGHT)\
+/* Crop an image; use libslim_crop instead */
+#define libslim_crop_generic__(OUT, IN, LEFT, TOP, WIDTH, HEIGHT)\
 	do {\
 		size_t i__;\
 		size_t w__ = (WIDTH);\
@@ -547,7 +673,7 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 		for (y__ = 0; y__ < h__; y__++) {\
 			for (x__ = 0; x__ < w__; x__++) {\
 				(OUT)->data[x__] = (IN)->data[x__];\
-				if ((IN)->data[i__].a) {\
+				if ((IN)->data[x__].a) {\
 					(OUT)->data[x__].CH1 /= (IN)->data[x__].a;\
 					(OUT)->data[x__].CH2 /= (IN)->data[x__].a;\
 					(OUT)->data[x__].CH3 /= (IN)->data[x__].a;\
@@ -590,7 +716,7 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 		for (y__ = 0; y__ < h__; y__++) {\
 			for (x__ = 0; x__ < w__; x__++) {\
 				(OUT)->data[x__] = (IN)->data[x__];\
-				if ((IN)->data[i__].a) {\
+				if ((IN)->data[x__].a) {\
 					(OUT)->data[x__].CH1 /= (IN)->data[x__].a;\
 					(OUT)->data[x__].CH2 /= (IN)->data[x__].a;\
 				}\
@@ -631,7 +757,7 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 		for (y__ = 0; y__ < h__; y__++) {\
 			for (x__ = 0; x__ < w__; x__++) {\
 				(OUT)->data[x__] = (IN)->data[x__];\
-				if ((IN)->data[i__].a)\
+				if ((IN)->data[x__].a)\
 					(OUT)->data[x__].CH /= (IN)->data[x__].a;\
 			}\
 			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
@@ -668,7 +794,7 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 		for (y__ = 0; y__ < h__; y__++) {\
 			for (x__ = 0; x__ < w__; x__++) {\
 				(OUT)->data[x__] = (IN)->data[x__];\
-				if ((IN)->data[i__].a) {\
+				if ((IN)->data[x__].a) {\
 					(OUT)->data[x__].CH1 /= (IN)->data[x__].a;\
 					(OUT)->data[x__].CH2 /= (IN)->data[x__].a;\
 					(OUT)->data[x__].CH3 /= (IN)->data[x__].a;\
@@ -676,7 +802,7 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 					(OUT)->data[x__].CH1 = (ZERO)->CH1;\
 					(OUT)->data[x__].CH2 = (ZERO)->CH2;\
 					(OUT)->data[x__].CH3 = (ZERO)->CH3;\
-				}
+				}\
 			}\
 			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
 			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
@@ -698,9 +824,9 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 				(OUT)->data[i__].CH2 /= (IN)->data[i__].a;\
 				(OUT)->data[i__].CH3 /= (IN)->data[i__].a;\
 			} else {\
-				(OUT)->data[x__].CH1 = (ZERO)->CH1;\
-				(OUT)->data[x__].CH2 = (ZERO)->CH2;\
-				(OUT)->data[x__].CH3 = (ZERO)->CH3;\
+				(OUT)->data[i__].CH1 = (ZERO)->CH1;\
+				(OUT)->data[i__].CH2 = (ZERO)->CH2;\
+				(OUT)->data[i__].CH3 = (ZERO)->CH3;\
 			}\
 		}\
 	} while (0)
@@ -719,7 +845,7 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 		for (y__ = 0; y__ < h__; y__++) {\
 			for (x__ = 0; x__ < w__; x__++) {\
 				(OUT)->data[x__] = (IN)->data[x__];\
-				if ((IN)->data[i__].a) {\
+				if ((IN)->data[x__].a) {\
 					(OUT)->data[x__].CH1 /= (IN)->data[x__].a;\
 					(OUT)->data[x__].CH2 /= (IN)->data[x__].a;\
 				} else {\
@@ -746,8 +872,8 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 				(OUT)->data[i__].CH1 /= (IN)->data[i__].a;\
 				(OUT)->data[i__].CH2 /= (IN)->data[i__].a;\
 			} else {\
-				(OUT)->data[x__].CH1 = (ZERO)->CH1;\
-				(OUT)->data[x__].CH2 = (ZERO)->CH2;\
+				(OUT)->data[i__].CH1 = (ZERO)->CH1;\
+				(OUT)->data[i__].CH2 = (ZERO)->CH2;\
 			}\
 		}\
 	} while (0)
@@ -766,7 +892,7 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 		for (y__ = 0; y__ < h__; y__++) {\
 			for (x__ = 0; x__ < w__; x__++) {\
 				(OUT)->data[x__] = (IN)->data[x__];\
-				if ((IN)->data[i__].a)\
+				if ((IN)->data[x__].a)\
 					(OUT)->data[x__].CH /= (IN)->data[x__].a;\
 				else\
 					(OUT)->data[x__].CH = (ZERO)->CH;\
@@ -789,9 +915,1683 @@ LIBSLIM_DECLARE_FORMAT(rgb_ld, { long double r, g, b; });
 			if ((IN)->data[i__].a)\
 				(OUT)->data[i__].CH /= (IN)->data[i__].a;\
 			else\
-				(OUT)->data[x__].CH = (ZERO)->CH;\
+				(OUT)->data[i__].CH = (ZERO)->CH;\
+		}\
+	} while (0)
+
+
+/* The curve macros need the type of the channels for temporaries
+ * to be kept in registers, and, as the compiler cannot tell that
+ * the lookup tables do not overlap the output image, must assert
+ * that the pixels can be processed independently to be vectorised */
+#if defined(__GNUC__)
+# define LIBSLIM_CURVE_TYPE__(RESULT) __typeof__(RESULT)
+#else
+# define LIBSLIM_CURVE_TYPE__(RESULT) long double
+#endif
+#if defined(__clang__)
+# define LIBSLIM_IVDEP__ _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+# define LIBSLIM_IVDEP__ _Pragma("GCC ivdep")
+#else
+# define LIBSLIM_IVDEP__
+#endif
+
+
+/* Map a floating-point value in [0, 1] through a curve, given as
+ * a lookup table of N, at least 2, finite values evenly spaced over
+ * [0, 1], using linear interpolation between the table entries; for
+ * integer channels, use libslim_sample_curve_index instead; values
+ * outside [0, 1] are clamped with selects rather than branches,
+ * letting the compiler vectorise the calling loop with gathers;
+ * the bounds are derived from the table, as constant bounds let
+ * the compiler split the loop body into branches */
+#define libslim_sample_curve(RESULT, LUT, N, VALUE)\
+	do {\
+		int ci__;\
+		LIBSLIM_CURVE_TYPE__(RESULT) cv__ = (VALUE);\
+		LIBSLIM_CURVE_TYPE__(RESULT) c0__ = (LUT)[0] - (LUT)[0];\
+		cv__ = cv__ > c0__ ? cv__ : c0__;\
+		cv__ = cv__ < c0__ + 1 ? cv__ : c0__ + 1;\
+		cv__ *= (int)(N) - 1;\
+		ci__ = (int)cv__;\
+		ci__ = ci__ + 2 < (int)(N) ? ci__ : (int)(N) - 2;\
+		(RESULT) = (LUT)[ci__] + (cv__ - ci__) * ((LUT)[ci__ + 1] - (LUT)[ci__]);\
+	} while (0)
+
+
+/* Map a floating-point value in [0, 1] through a curve, given as
+ * a lookup table of N finite values evenly spaced over [0, 1], using
+ * the nearest table entry; this is faster than libslim_sample_curve
+ * and exact when the values are quantised to the table; for integer
+ * channels, use libslim_sample_curve_index instead */
+#define libslim_sample_curve_nearest(RESULT, LUT, N, VALUE)\
+	do {\
+		LIBSLIM_CURVE_TYPE__(RESULT) cv__ = (VALUE);\
+		LIBSLIM_CURVE_TYPE__(RESULT) c0__ = (LUT)[0] - (LUT)[0];\
+		cv__ = cv__ > c0__ ? cv__ : c0__;\
+		cv__ = cv__ < c0__ + 1 ? cv__ : c0__ + 1;\
+		(RESULT) = (LUT)[(int)(cv__ * ((int)(N) - 1) + .5f)];\
+	} while (0)
+
+
+/* Map an integer value, such as that of a u8 or u16 channel, through
+ * a curve, given as a lookup table with an entry for each value the
+ * channel can have, that is, N must be the maximum value of the
+ * channel plus one; VALUE is used directly as the index */
+#define libslim_sample_curve_index(RESULT, LUT, N, VALUE)\
+	do {\
+		(RESULT) = (LUT)[(VALUE)];\
+	} while (0)
+
+
+/* Copy the N pixels in the row IN to the row OUT, which must be of
+ * the same format, so that the channels the curve macros do not
+ * write are copied; copying each pixel in the curve loops would
+ * keep the compiler from vectorising them */
+#define libslim_curve_copy_row__(OUT, IN, N)\
+	memmove((OUT), (IN), (N) * sizeof(*(OUT)) + 0 * sizeof(*(OUT) = *(IN)))
+
+
+/* Apply curves to 3 channels in all pixels in an image; other
+ * channels are copied */
+#define libslim_apply_curve_3_channels(OUT, IN, SAMPLE, LUT1, LUT2, LUT3, N, CH1, CH2, CH3)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH1, (LUT1), (N), (IN)->data[x__].CH1);\
+				SAMPLE((OUT)->data[x__].CH2, (LUT2), (N), (IN)->data[x__].CH2);\
+				SAMPLE((OUT)->data[x__].CH3, (LUT3), (N), (IN)->data[x__].CH3);\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Apply curves to 3 channels in all pixels in a row of an image; other
+ * channels are copied */
+#define libslim_apply_curve_3_channels_row(OUT, IN, SAMPLE, LUT1, LUT2, LUT3, N, CH1, CH2, CH3)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH1, (LUT1), (N), (IN)->data[i__].CH1);\
+			SAMPLE((OUT)->data[i__].CH2, (LUT2), (N), (IN)->data[i__].CH2);\
+			SAMPLE((OUT)->data[i__].CH3, (LUT3), (N), (IN)->data[i__].CH3);\
+		}\
+	} while (0)
+
+
+/* Apply curves to 2 channels in all pixels in an image; other
+ * channels are copied */
+#define libslim_apply_curve_2_channels(OUT, IN, SAMPLE, LUT1, LUT2, N, CH1, CH2)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH1, (LUT1), (N), (IN)->data[x__].CH1);\
+				SAMPLE((OUT)->data[x__].CH2, (LUT2), (N), (IN)->data[x__].CH2);\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Apply curves to 2 channels in all pixels in a row of an image; other
+ * channels are copied */
+#define libslim_apply_curve_2_channels_row(OUT, IN, SAMPLE, LUT1, LUT2, N, CH1, CH2)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH1, (LUT1), (N), (IN)->data[i__].CH1);\
+			SAMPLE((OUT)->data[i__].CH2, (LUT2), (N), (IN)->data[i__].CH2);\
+		}\
+	} while (0)
+
+
+/* Apply curves to 1 channel in all pixels in an image; other
+ * channels are copied */
+#define libslim_apply_curve_1_channel(OUT, IN, SAMPLE, LUT, N, CH)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH, (LUT), (N), (IN)->data[x__].CH);\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Apply curves to 1 channel in all pixels in a row of an image; other
+ * channels are copied */
+#define libslim_apply_curve_1_channel_row(OUT, IN, SAMPLE, LUT, N, CH)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH, (LUT), (N), (IN)->data[i__].CH);\
+		}\
+	} while (0)
+
+
+/* Apply curves to 3 channels in all pixels in an image, and
+ * premultiply them; other channels are copied */
+#define libslim_apply_curve_3_channels_premultiply(OUT, IN, SAMPLE, LUT1, LUT2, LUT3, N, CH1, CH2, CH3)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH1, (LUT1), (N), (IN)->data[x__].CH1);\
+				(OUT)->data[x__].CH1 *= (IN)->data[x__].a;\
+				SAMPLE((OUT)->data[x__].CH2, (LUT2), (N), (IN)->data[x__].CH2);\
+				(OUT)->data[x__].CH2 *= (IN)->data[x__].a;\
+				SAMPLE((OUT)->data[x__].CH3, (LUT3), (N), (IN)->data[x__].CH3);\
+				(OUT)->data[x__].CH3 *= (IN)->data[x__].a;\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Apply curves to 3 channels in all pixels in a row of an image, and
+ * premultiply them; other channels are copied */
+#define libslim_apply_curve_3_channels_premultiply_row(OUT, IN, SAMPLE, LUT1, LUT2, LUT3, N, CH1, CH2, CH3)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH1, (LUT1), (N), (IN)->data[i__].CH1);\
+			(OUT)->data[i__].CH1 *= (IN)->data[i__].a;\
+			SAMPLE((OUT)->data[i__].CH2, (LUT2), (N), (IN)->data[i__].CH2);\
+			(OUT)->data[i__].CH2 *= (IN)->data[i__].a;\
+			SAMPLE((OUT)->data[i__].CH3, (LUT3), (N), (IN)->data[i__].CH3);\
+			(OUT)->data[i__].CH3 *= (IN)->data[i__].a;\
+		}\
+	} while (0)
+
+
+/* Apply curves to 2 channels in all pixels in an image, and
+ * premultiply them; other channels are copied */
+#define libslim_apply_curve_2_channels_premultiply(OUT, IN, SAMPLE, LUT1, LUT2, N, CH1, CH2)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH1, (LUT1), (N), (IN)->data[x__].CH1);\
+				(OUT)->data[x__].CH1 *= (IN)->data[x__].a;\
+				SAMPLE((OUT)->data[x__].CH2, (LUT2), (N), (IN)->data[x__].CH2);\
+				(OUT)->data[x__].CH2 *= (IN)->data[x__].a;\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
 		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
 	} while (0)
 
 
+/* Apply curves to 2 channels in all pixels in a row of an image, and
+ * premultiply them; other channels are copied */
+#define libslim_apply_curve_2_channels_premultiply_row(OUT, IN, SAMPLE, LUT1, LUT2, N, CH1, CH2)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH1, (LUT1), (N), (IN)->data[i__].CH1);\
+			(OUT)->data[i__].CH1 *= (IN)->data[i__].a;\
+			SAMPLE((OUT)->data[i__].CH2, (LUT2), (N), (IN)->data[i__].CH2);\
+			(OUT)->data[i__].CH2 *= (IN)->data[i__].a;\
+		}\
+	} while (0)
+
+
+/* Apply curves to 1 channel in all pixels in an image, and
+ * premultiply them; other channels are copied */
+#define libslim_apply_curve_1_channel_premultiply(OUT, IN, SAMPLE, LUT, N, CH)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH, (LUT), (N), (IN)->data[x__].CH);\
+				(OUT)->data[x__].CH *= (IN)->data[x__].a;\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Apply curves to 1 channel in all pixels in a row of an image, and
+ * premultiply them; other channels are copied */
+#define libslim_apply_curve_1_channel_premultiply_row(OUT, IN, SAMPLE, LUT, N, CH)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH, (LUT), (N), (IN)->data[i__].CH);\
+			(OUT)->data[i__].CH *= (IN)->data[i__].a;\
+		}\
+	} while (0)
+
+
+/* Unpremultiply 3 channels in all pixels in an image, and
+ * apply curves to them; other channels are copied */
+#define libslim_apply_curve_3_channels_unpremultiply(OUT, IN, SAMPLE, LUT1, LUT2, LUT3, N, CH1, CH2, CH3)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH1, (LUT1), (N), (IN)->data[x__].CH1 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				SAMPLE((OUT)->data[x__].CH2, (LUT2), (N), (IN)->data[x__].CH2 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				SAMPLE((OUT)->data[x__].CH3, (LUT3), (N), (IN)->data[x__].CH3 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Unpremultiply 3 channels in all pixels in a row of an image, and
+ * apply curves to them; other channels are copied */
+#define libslim_apply_curve_3_channels_unpremultiply_row(OUT, IN, SAMPLE, LUT1, LUT2, LUT3, N, CH1, CH2, CH3)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH1, (LUT1), (N), (IN)->data[i__].CH1 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			SAMPLE((OUT)->data[i__].CH2, (LUT2), (N), (IN)->data[i__].CH2 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			SAMPLE((OUT)->data[i__].CH3, (LUT3), (N), (IN)->data[i__].CH3 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+		}\
+	} while (0)
+
+
+/* Unpremultiply 2 channels in all pixels in an image, and
+ * apply curves to them; other channels are copied */
+#define libslim_apply_curve_2_channels_unpremultiply(OUT, IN, SAMPLE, LUT1, LUT2, N, CH1, CH2)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH1, (LUT1), (N), (IN)->data[x__].CH1 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				SAMPLE((OUT)->data[x__].CH2, (LUT2), (N), (IN)->data[x__].CH2 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Unpremultiply 2 channels in all pixels in a row of an image, and
+ * apply curves to them; other channels are copied */
+#define libslim_apply_curve_2_channels_unpremultiply_row(OUT, IN, SAMPLE, LUT1, LUT2, N, CH1, CH2)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH1, (LUT1), (N), (IN)->data[i__].CH1 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			SAMPLE((OUT)->data[i__].CH2, (LUT2), (N), (IN)->data[i__].CH2 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+		}\
+	} while (0)
+
+
+/* Unpremultiply 1 channel in all pixels in an image, and
+ * apply curves to them; other channels are copied */
+#define libslim_apply_curve_1_channel_unpremultiply(OUT, IN, SAMPLE, LUT, N, CH)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH, (LUT), (N), (IN)->data[x__].CH / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Unpremultiply 1 channel in all pixels in a row of an image, and
+ * apply curves to them; other channels are copied */
+#define libslim_apply_curve_1_channel_unpremultiply_row(OUT, IN, SAMPLE, LUT, N, CH)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH, (LUT), (N), (IN)->data[i__].CH / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+		}\
+	} while (0)
+
+
+/* Apply curves to the unpremultiplied values of 3 channels in all
+ * pixels in an image, keeping the image premultiplied;
+ * other channels are copied */
+#define libslim_apply_curve_3_channels_premultiplied(OUT, IN, SAMPLE, LUT1, LUT2, LUT3, N, CH1, CH2, CH3)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH1, (LUT1), (N), (IN)->data[x__].CH1 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				(OUT)->data[x__].CH1 *= (IN)->data[x__].a;\
+				SAMPLE((OUT)->data[x__].CH2, (LUT2), (N), (IN)->data[x__].CH2 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				(OUT)->data[x__].CH2 *= (IN)->data[x__].a;\
+				SAMPLE((OUT)->data[x__].CH3, (LUT3), (N), (IN)->data[x__].CH3 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				(OUT)->data[x__].CH3 *= (IN)->data[x__].a;\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Apply curves to the unpremultiplied values of 3 channels in all
+ * pixels in a row of an image, keeping the image premultiplied;
+ * other channels are copied */
+#define libslim_apply_curve_3_channels_premultiplied_row(OUT, IN, SAMPLE, LUT1, LUT2, LUT3, N, CH1, CH2, CH3)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH1, (LUT1), (N), (IN)->data[i__].CH1 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			(OUT)->data[i__].CH1 *= (IN)->data[i__].a;\
+			SAMPLE((OUT)->data[i__].CH2, (LUT2), (N), (IN)->data[i__].CH2 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			(OUT)->data[i__].CH2 *= (IN)->data[i__].a;\
+			SAMPLE((OUT)->data[i__].CH3, (LUT3), (N), (IN)->data[i__].CH3 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			(OUT)->data[i__].CH3 *= (IN)->data[i__].a;\
+		}\
+	} while (0)
+
+
+/* Apply curves to the unpremultiplied values of 2 channels in all
+ * pixels in an image, keeping the image premultiplied;
+ * other channels are copied */
+#define libslim_apply_curve_2_channels_premultiplied(OUT, IN, SAMPLE, LUT1, LUT2, N, CH1, CH2)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH1, (LUT1), (N), (IN)->data[x__].CH1 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				(OUT)->data[x__].CH1 *= (IN)->data[x__].a;\
+				SAMPLE((OUT)->data[x__].CH2, (LUT2), (N), (IN)->data[x__].CH2 / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				(OUT)->data[x__].CH2 *= (IN)->data[x__].a;\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Apply curves to the unpremultiplied values of 2 channels in all
+ * pixels in a row of an image, keeping the image premultiplied;
+ * other channels are copied */
+#define libslim_apply_curve_2_channels_premultiplied_row(OUT, IN, SAMPLE, LUT1, LUT2, N, CH1, CH2)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH1, (LUT1), (N), (IN)->data[i__].CH1 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			(OUT)->data[i__].CH1 *= (IN)->data[i__].a;\
+			SAMPLE((OUT)->data[i__].CH2, (LUT2), (N), (IN)->data[i__].CH2 / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			(OUT)->data[i__].CH2 *= (IN)->data[i__].a;\
+		}\
+	} while (0)
+
+
+/* Apply curves to the unpremultiplied values of 1 channel in all
+ * pixels in an image, keeping the image premultiplied;
+ * other channels are copied */
+#define libslim_apply_curve_1_channel_premultiplied(OUT, IN, SAMPLE, LUT, N, CH)\
+	do {\
+		size_t x__, y__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.width = w__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			libslim_curve_copy_row__((OUT)->data, (IN)->data, w__);\
+			LIBSLIM_IVDEP__\
+			for (x__ = 0; x__ < w__; x__++) {\
+				SAMPLE((OUT)->data[x__].CH, (LUT), (N), (IN)->data[x__].CH / ((IN)->data[x__].a + ((IN)->data[x__].a == 0)));\
+				(OUT)->data[x__].CH *= (IN)->data[x__].a;\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Apply curves to the unpremultiplied values of 1 channel in all
+ * pixels in a row of an image, keeping the image premultiplied;
+ * other channels are copied */
+#define libslim_apply_curve_1_channel_premultiplied_row(OUT, IN, SAMPLE, LUT, N, CH)\
+	do {\
+		size_t i__;\
+		size_t n__ = (IN)->meta.width;\
+		libslim_curve_copy_row__((OUT)->data, (IN)->data, n__);\
+		LIBSLIM_IVDEP__\
+		for (i__ = 0; i__ < n__; i__++) {\
+			SAMPLE((OUT)->data[i__].CH, (LUT), (N), (IN)->data[i__].CH / ((IN)->data[i__].a + ((IN)->data[i__].a == 0)));\
+			(OUT)->data[i__].CH *= (IN)->data[i__].a;\
+		}\
+	} while (0)
+
+
+/* Get the position of a pixel within a tile stored in Morton order */
+static inline size_t
+libslim_morton_index__(size_t x, size_t y)
+{
+	size_t i, r = 0;
+	for (i = 0; i < LIBSLIM_TILE_SHIFT; i++) {
+		r |= ((x >> i) & 1) << (2 * i);
+		r |= ((y >> i) & 1) << (2 * i + 1);
+	}
+	return r;
+}
+
+
+/* Get the position of a pixel within a tile of a tiled image */
+#define libslim_tile_offset__(IMG, LX, LY)\
+	((IMG)->meta.zorder ? libslim_morton_index__((LX), (LY)) : ((LY) << LIBSLIM_TILE_SHIFT | (LX)))
+
+
+/* Get the index, in the data of a tiled image, of a pixel,
+ * the coordinates include the padding before the image */
+#define libslim_tiled_grid_index__(IMG, X, Y)\
+	(((((Y) >> LIBSLIM_TILE_SHIFT) * (IMG)->meta.tiles_across + ((X) >> LIBSLIM_TILE_SHIFT)) << (2 * LIBSLIM_TILE_SHIFT)) +\
+	 libslim_tile_offset__((IMG), (X) & LIBSLIM_TILE_MASK, (Y) & LIBSLIM_TILE_MASK))
+
+
+/* Get the index, in the data of a tiled image, of a pixel */
+#define libslim_tiled_index(IMG, X, Y)\
+	libslim_tiled_grid_index__((IMG), (X) + (IMG)->meta.left, (Y) + (IMG)->meta.top)
+
+
+/* Get the number of pixels to allocate for a tiled image; this
+ * does not change when the image is transformed with the tiled
+ * operations */
+#define libslim_tiled_size(WIDTH, HEIGHT)\
+	((((WIDTH) + LIBSLIM_TILE_MASK) >> LIBSLIM_TILE_SHIFT) *\
+	 (((HEIGHT) + LIBSLIM_TILE_MASK) >> LIBSLIM_TILE_SHIFT) * LIBSLIM_TILE_AREA)
+
+
+/* Convert an image to a tiled image, (OUT)->meta.zorder selects
+ * the layout of the pixels in each tile, and must be set by the caller;
+ * the padding in the tiles along the right and bottom edges is zeroed */
+#define libslim_tile(OUT, IN)\
+	do {\
+		size_t x__, y__, i__, n__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *in__ = (IN)->data;\
+		(OUT)->meta.width = w__;\
+		(OUT)->meta.height = h__;\
+		(OUT)->meta.left = 0;\
+		(OUT)->meta.top = 0;\
+		(OUT)->meta.tiles_across = (w__ + LIBSLIM_TILE_MASK) >> LIBSLIM_TILE_SHIFT;\
+		(OUT)->meta.tiles_down = (h__ + LIBSLIM_TILE_MASK) >> LIBSLIM_TILE_SHIFT;\
+		if (w__ & LIBSLIM_TILE_MASK)\
+			for (i__ = 0; i__ < (OUT)->meta.tiles_down; i__++)\
+				memset(&(OUT)->data[((i__ + 1) * (OUT)->meta.tiles_across - 1) << (2 * LIBSLIM_TILE_SHIFT)],\
+				       0, LIBSLIM_TILE_AREA * sizeof(*(OUT)->data));\
+		if (h__ & LIBSLIM_TILE_MASK)\
+			memset(&(OUT)->data[((OUT)->meta.tiles_down - 1) * (OUT)->meta.tiles_across << (2 * LIBSLIM_TILE_SHIFT)],\
+			       0, (OUT)->meta.tiles_across * LIBSLIM_TILE_AREA * sizeof(*(OUT)->data));\
+		for (y__ = 0; y__ < h__; y__++) {\
+			for (x__ = 0; x__ < w__; x__ += n__) {\
+				n__ = LIBSLIM_TILE_SIZE - (x__ & LIBSLIM_TILE_MASK);\
+				n__ = n__ < w__ - x__ ? n__ : w__ - x__;\
+				if ((OUT)->meta.zorder) {\
+					for (i__ = 0; i__ < n__; i__++)\
+						(OUT)->data[libslim_tiled_index((OUT), x__ + i__, y__)] = (IN)->data[x__ + i__];\
+				} else {\
+					memcpy(&(OUT)->data[libslim_tiled_index((OUT), x__, y__)],\
+					       &(IN)->data[x__], n__ * sizeof(*(IN)->data));\
+				}\
+			}\
+			(IN)->data += (IN)->meta.width + (IN)->meta.hblank;\
+		}\
+		(IN)->data = in__;\
+	} while (0)
+
+
+/* Convert a tiled image to an image */
+#define libslim_untile(OUT, IN)\
+	do {\
+		size_t x__, y__, i__, n__;\
+		size_t h__ = (IN)->meta.height;\
+		size_t w__ = (IN)->meta.width;\
+		void *out__ = (OUT)->data;\
+		(OUT)->meta.width = w__;\
+		(OUT)->meta.height = h__;\
+		for (y__ = 0; y__ < h__; y__++) {\
+			for (x__ = 0; x__ < w__; x__ += n__) {\
+				n__ = LIBSLIM_TILE_SIZE - ((x__ + (IN)->meta.left) & LIBSLIM_TILE_MASK);\
+				n__ = n__ < w__ - x__ ? n__ : w__ - x__;\
+				if ((IN)->meta.zorder) {\
+					for (i__ = 0; i__ < n__; i__++)\
+						(OUT)->data[x__ + i__] = (IN)->data[libslim_tiled_index((IN), x__ + i__, y__)];\
+				} else {\
+					memcpy(&(OUT)->data[x__], &(IN)->data[libslim_tiled_index((IN), x__, y__)],\
+					       n__ * sizeof(*(IN)->data));\
+				}\
+			}\
+			(OUT)->data += (OUT)->meta.width + (OUT)->meta.hblank;\
+		}\
+		(OUT)->data = out__;\
+	} while (0)
+
+
+/* Move the pixels in the row ly__ of a tile, between tiles
+ * with the linear layout, one by one, see libslim_tiled_move__ */
+#define libslim_tiled_move_pixels__(OUT, IN, LX, LY)\
+	do {\
+		for (lx__ = 0; lx__ < LIBSLIM_TILE_SIZE; lx__++)\
+			(OUT)->data[ot__ + ((LY) << LIBSLIM_TILE_SHIFT | (LX))] =\
+				(IN)->data[it__ + (ly__ << LIBSLIM_TILE_SHIFT | lx__)];\
+	} while (0)
+
+
+/* Move the row ly__ of a tile, between tiles with the linear
+ * layout, as a whole, when LX is lx__ */
+#define libslim_tiled_move_row__(OUT, IN, LX, LY)\
+	memcpy(&(OUT)->data[ot__ + ((LY) << LIBSLIM_TILE_SHIFT)],\
+	       &(IN)->data[it__ + (ly__ << LIBSLIM_TILE_SHIFT)],\
+	       LIBSLIM_TILE_SIZE * sizeof(*(IN)->data))
+
+
+/* Move all tiles of a tiled image; for the pixel at lx__, ly__
+ * in the tile tx__, ty__ of the input, TX, TY select the tile in
+ * the output and LX, LY select the position within that tile,
+ * ta__ and td__ are the number of tiles across and down in the
+ * input; if neither image is in Morton order, ROW is used to
+ * move each row of a tile; (OUT)->meta must already be set */
+#define libslim_tiled_move__(OUT, IN, TX, TY, LX, LY, ROW)\
+	do {\
+		size_t tx__, ty__, lx__, ly__, it__, ot__;\
+		size_t ta__ = (IN)->meta.tiles_across;\
+		size_t td__ = (IN)->meta.tiles_down;\
+		int linear__ = !(IN)->meta.zorder && !(OUT)->meta.zorder;\
+		for (ty__ = 0; ty__ < td__; ty__++) {\
+			for (tx__ = 0; tx__ < ta__; tx__++) {\
+				it__ = (ty__ * ta__ + tx__) << (2 * LIBSLIM_TILE_SHIFT);\
+				ot__ = ((TY) * (OUT)->meta.tiles_across + (TX)) << (2 * LIBSLIM_TILE_SHIFT);\
+				if (linear__) {\
+					for (ly__ = 0; ly__ < LIBSLIM_TILE_SIZE; ly__++)\
+						ROW((OUT), (IN), LX, LY);\
+					continue;\
+				}\
+				for (ly__ = 0; ly__ < LIBSLIM_TILE_SIZE; ly__++)\
+					for (lx__ = 0; lx__ < LIBSLIM_TILE_SIZE; lx__++)\
+						(OUT)->data[ot__ + libslim_tile_offset__((OUT), (LX), (LY))] =\
+							(IN)->data[it__ + libslim_tile_offset__((IN), lx__, ly__)];\
+			}\
+		}\
+	} while (0)
+
+
+/* Horizontally flip a tiled image */
+#define libslim_tiled_flop(OUT, IN)\
+	do {\
+		(OUT)->meta.width = (IN)->meta.width;\
+		(OUT)->meta.height = (IN)->meta.height;\
+		(OUT)->meta.left = ((IN)->meta.tiles_across << LIBSLIM_TILE_SHIFT) - (IN)->meta.width - (IN)->meta.left;\
+		(OUT)->meta.top = (IN)->meta.top;\
+		(OUT)->meta.tiles_across = (IN)->meta.tiles_across;\
+		(OUT)->meta.tiles_down = (IN)->meta.tiles_down;\
+		libslim_tiled_move__((OUT), (IN), ta__ - 1 - tx__, ty__, LIBSLIM_TILE_MASK - lx__, ly__,\
+		                     libslim_tiled_move_pixels__);\
+	} while (0)
+
+
+/* Vertically flip a tiled image */
+#define libslim_tiled_flip(OUT, IN)\
+	do {\
+		(OUT)->meta.width = (IN)->meta.width;\
+		(OUT)->meta.height = (IN)->meta.height;\
+		(OUT)->meta.left = (IN)->meta.left;\
+		(OUT)->meta.top = ((IN)->meta.tiles_down << LIBSLIM_TILE_SHIFT) - (IN)->meta.height - (IN)->meta.top;\
+		(OUT)->meta.tiles_across = (IN)->meta.tiles_across;\
+		(OUT)->meta.tiles_down = (IN)->meta.tiles_down;\
+		libslim_tiled_move__((OUT), (IN), tx__, td__ - 1 - ty__, lx__, LIBSLIM_TILE_MASK - ly__,\
+		                     libslim_tiled_move_row__);\
+	} while (0)
+
+
+/* Transpose a tiled image */
+#define libslim_tiled_transpose(OUT, IN)\
+	do {\
+		(OUT)->meta.width = (IN)->meta.height;\
+		(OUT)->meta.height = (IN)->meta.width;\
+		(OUT)->meta.left = (IN)->meta.top;\
+		(OUT)->meta.top = (IN)->meta.left;\
+		(OUT)->meta.tiles_across = (IN)->meta.tiles_down;\
+		(OUT)->meta.tiles_down = (IN)->meta.tiles_across;\
+		libslim_tiled_move__((OUT), (IN), ty__, tx__, ly__, lx__, libslim_tiled_move_pixels__);\
+	} while (0)
+
+
+/* Rotate a tiled image 90 degrees clockwise */
+#define libslim_tiled_rotate_90(OUT, IN)\
+	do {\
+		(OUT)->meta.width = (IN)->meta.height;\
+		(OUT)->meta.height = (IN)->meta.width;\
+		(OUT)->meta.left = ((IN)->meta.tiles_down << LIBSLIM_TILE_SHIFT) - (IN)->meta.height - (IN)->meta.top;\
+		(OUT)->meta.top = (IN)->meta.left;\
+		(OUT)->meta.tiles_across = (IN)->meta.tiles_down;\
+		(OUT)->meta.tiles_down = (IN)->meta.tiles_across;\
+		libslim_tiled_move__((OUT), (IN), td__ - 1 - ty__, tx__, LIBSLIM_TILE_MASK - ly__, lx__,\
+		                     libslim_tiled_move_pixels__);\
+	} while (0)
+
+
+/* Rotate a tiled image 180 degrees */
+#define libslim_tiled_rotate_180(OUT, IN)\
+	do {\
+		(OUT)->meta.width = (IN)->meta.width;\
+		(OUT)->meta.height = (IN)->meta.height;\
+		(OUT)->meta.left = ((IN)->meta.tiles_across << LIBSLIM_TILE_SHIFT) - (IN)->meta.width - (IN)->meta.left;\
+		(OUT)->meta.top = ((IN)->meta.tiles_down << LIBSLIM_TILE_SHIFT) - (IN)->meta.height - (IN)->meta.top;\
+		(OUT)->meta.tiles_across = (IN)->meta.tiles_across;\
+		(OUT)->meta.tiles_down = (IN)->meta.tiles_down;\
+		libslim_tiled_move__((OUT), (IN), ta__ - 1 - tx__, td__ - 1 - ty__,\
+		                     LIBSLIM_TILE_MASK - lx__, LIBSLIM_TILE_MASK - ly__,\
+		                     libslim_tiled_move_pixels__);\
+	} while (0)
+
+
+/* Rotate a tiled image 270 degrees clockwise */
+#define libslim_tiled_rotate_270(OUT, IN)\
+	do {\
+		(OUT)->meta.width = (IN)->meta.height;\
+		(OUT)->meta.height = (IN)->meta.width;\
+		(OUT)->meta.left = (IN)->meta.top;\
+		(OUT)->meta.top = ((IN)->meta.tiles_across << LIBSLIM_TILE_SHIFT) - (IN)->meta.width - (IN)->meta.left;\
+		(OUT)->meta.tiles_across = (IN)->meta.tiles_down;\
+		(OUT)->meta.tiles_down = (IN)->meta.tiles_across;\
+		libslim_tiled_move__((OUT), (IN), ty__, ta__ - 1 - tx__, ly__, LIBSLIM_TILE_MASK - lx__,\
+		                     libslim_tiled_move_pixels__);\
+	} while (0)
+
+
+/* Iterate over the tiles of a tiled image, presenting each tile
+ * as an image, (ROW), with a single row; this lets row operations
+ * that do not depend on the position of the pixels, for example
+ * libslim_premultiply_3_channels_row, be applied to tiled images */
+#define libslim_tiled_foreach_tile(ROW, IMG)\
+	for ((ROW)->meta.width = LIBSLIM_TILE_AREA, (ROW)->meta.height = 1, (ROW)->meta.hblank = 0,\
+	     (ROW)->meta.dirty = NULL, (ROW)->data = (IMG)->data;\
+	     (ROW)->data != (IMG)->data + (IMG)->meta.tiles_across * (IMG)->meta.tiles_down * LIBSLIM_TILE_AREA;\
+	     (ROW)->data += LIBSLIM_TILE_AREA)
+
+
+/* Iterate over the tiles of two tiled images in lockstep, the
+ * images must have the same dimensions and layout */
+#define libslim_tiled_foreach_tile_pair(OUT_ROW, OUT, IN_ROW, IN)\
+	for ((OUT_ROW)->meta.width = (IN_ROW)->meta.width = LIBSLIM_TILE_AREA,\
+	     (OUT_ROW)->meta.height = (IN_ROW)->meta.height = 1,\
+	     (OUT_ROW)->meta.hblank = (IN_ROW)->meta.hblank = 0,\
+	     (OUT_ROW)->meta.dirty = (IN_ROW)->meta.dirty = NULL,\
+	     (OUT_ROW)->data = (OUT)->data, (IN_ROW)->data = (IN)->data;\
+	     (IN_ROW)->data != (IN)->data + (IN)->meta.tiles_across * (IN)->meta.tiles_down * LIBSLIM_TILE_AREA;\
+	     (OUT_ROW)->data += LIBSLIM_TILE_AREA, (IN_ROW)->data += LIBSLIM_TILE_AREA)
+
+
+/* Check whether two rectangles overlap */
+static inline int
+libslim_rect_overlap__(const struct libslim_rect *a, const struct libslim_rect *b)
+{
+	return a->left < b->left + b->width && b->left < a->left + a->width &&
+	       a->top < b->top + b->height && b->top < a->top + a->height;
+}
+
+
+/* Grow a rectangle to cover another rectangle */
+static inline void
+libslim_rect_union__(struct libslim_rect *a, const struct libslim_rect *b)
+{
+	size_t right = a->left + a->width;
+	size_t bottom = a->top + a->height;
+	if (b->left + b->width > right)
+		right = b->left + b->width;
+	if (b->top + b->height > bottom)
+		bottom = b->top + b->height;
+	if (b->left < a->left)
+		a->left = b->left;
+	if (b->top < a->top)
+		a->top = b->top;
+	a->width = right - a->left;
+	a->height = bottom - a->top;
+}
+
+
+/* Mark no part of an image as dirty */
+static inline void
+libslim_dirty_clear(struct libslim_dirty_region *region)
+{
+	region->count = 0;
+}
+
+
+/* Mark a rectangle of an image as dirty; overlapping rectangles
+ * are merged, and when the region is full, the rectangle is
+ * merged with the rectangle it grows the least */
+static inline void
+libslim_dirty_add(struct libslim_dirty_region *region, size_t left, size_t top, size_t width, size_t height)
+{
+	struct libslim_rect rect, u;
+	size_t i, best = 0, growth, best_growth = SIZE_MAX;
+	if (!width || !height)
+		return;
+	rect.left = left;
+	rect.top = top;
+	rect.width = width;
+	rect.height = height;
+again:
+	for (i = 0; i < region->count; i++) {
+		if (libslim_rect_overlap__(&region->rects[i], &rect)) {
+			libslim_rect_union__(&rect, &region->rects[i]);
+			region->rects[i] = region->rects[--region->count];
+			goto again;
+		}
+	}
+	if (region->count == LIBSLIM_MAX_DIRTY_RECTS) {
+		for (i = 0; i < region->count; i++) {
+			u = region->rects[i];
+			libslim_rect_union__(&u, &rect);
+			growth = u.width * u.height - region->rects[i].width * region->rects[i].height;
+			if (growth < best_growth) {
+				best_growth = growth;
+				best = i;
+			}
+		}
+		libslim_rect_union__(&rect, &region->rects[best]);
+		region->rects[best] = region->rects[--region->count];
+		goto again;
+	}
+	region->rects[region->count++] = rect;
+}
+
+
+/* Mark all dirty rectangles in one region as dirty in another region */
+static inline void
+libslim_dirty_add_region(struct libslim_dirty_region *region, const struct libslim_dirty_region *from)
+{
+	size_t i;
+	for (i = 0; i < from->count; i++)
+		libslim_dirty_add(region, from->rects[i].left, from->rects[i].top, from->rects[i].width, from->rects[i].height);
+}
+
+
+/* Apply an operation, taking an output image, an input image and
+ * at least one more argument, for example libslim_premultiply_3_channels,
+ * only to the dirty rectangles of the input image, and mark them
+ * as dirty in the output image; (OUT)->meta.hblank must be set;
+ * like the wrapped operations, OUT and IN must be distinct structs,
+ * to process an image in place, pass a copy of its struct as OUT */
+#define libslim_dirty_apply(OP, OUT, IN, ...)\
+	do {\
+		size_t r__, rl__, rt__, rw__, rh__;\
+		struct libslim_image_meta in_meta__ = (IN)->meta;\
+		struct libslim_image_meta out_meta__ = (OUT)->meta;\
+		struct libslim_dirty_region *dirty__ = in_meta__.dirty;\
+		void *in_data__ = (IN)->data;\
+		void *out_data__ = (OUT)->data;\
+		if (!dirty__) {\
+			OP((OUT), (IN), __VA_ARGS__);\
+			if (out_meta__.dirty)\
+				libslim_dirty_add(out_meta__.dirty, 0, 0, in_meta__.width, in_meta__.height);\
+			break;\
+		}\
+		for (r__ = 0; r__ < dirty__->count; r__++) {\
+			rl__ = dirty__->rects[r__].left;\
+			rt__ = dirty__->rects[r__].top;\
+			if (rl__ >= in_meta__.width || rt__ >= in_meta__.height)\
+				continue;\
+			rw__ = in_meta__.width - rl__;\
+			rh__ = in_meta__.height - rt__;\
+			rw__ = dirty__->rects[r__].width < rw__ ? dirty__->rects[r__].width : rw__;\
+			rh__ = dirty__->rects[r__].height < rh__ ? dirty__->rects[r__].height : rh__;\
+			(IN)->data = in_data__;\
+			(IN)->data += rt__ * (in_meta__.width + in_meta__.hblank) + rl__;\
+			(IN)->meta.width = rw__;\
+			(IN)->meta.height = rh__;\
+			(IN)->meta.hblank = in_meta__.width + in_meta__.hblank - rw__;\
+			(OUT)->data = out_data__;\
+			(OUT)->data += rt__ * (in_meta__.width + out_meta__.hblank) + rl__;\
+			(OUT)->meta.width = rw__;\
+			(OUT)->meta.height = rh__;\
+			(OUT)->meta.hblank = in_meta__.width + out_meta__.hblank - rw__;\
+			OP((OUT), (IN), __VA_ARGS__);\
+			(IN)->meta = in_meta__;\
+			(IN)->data = in_data__;\
+			(OUT)->meta = out_meta__;\
+			(OUT)->data = out_data__;\
+			if (out_meta__.dirty && out_meta__.dirty != dirty__)\
+				libslim_dirty_add(out_meta__.dirty, rl__, rt__, rw__, rh__);\
+		}\
+		(OUT)->meta.width = in_meta__.width;\
+		(OUT)->meta.height = in_meta__.height;\
+	} while (0)
+
+
+/* Get the number of pixels to allocate for COUNT levels of an
+ * image pyramid, with hblank set to HBLANK in each level, for
+ * an image with the size WIDTH by HEIGHT; the image itself is
+ * not included */
+static inline size_t
+libslim_pyramid_size(size_t width, size_t height, size_t count, size_t hblank)
+{
+	size_t r = 0;
+	while (count--) {
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+		r += (width + hblank) * height;
+	}
+	return r;
+}
+
+
+/* Set up the levels, (LEVELS)[0] through (LEVELS)[(COUNT) - 1], of an
+ * image pyramid for an image with the size WIDTH by HEIGHT, stored
+ * contiguously in DATA, which must have room for libslim_pyramid_size
+ * pixels */
+#define libslim_pyramid_layout(LEVELS, COUNT, DATA, WIDTH, HEIGHT, HBLANK)\
+	do {\
+		size_t k__;\
+		size_t n__ = (COUNT);\
+		size_t w__ = (WIDTH);\
+		size_t h__ = (HEIGHT);\
+		for (k__ = 0; k__ < n__; k__++) {\
+			(LEVELS)[k__].data = k__ ? (LEVELS)[k__ - 1].data + (w__ + (HBLANK)) * h__ : (DATA);\
+			w__ = (w__ + 1) / 2;\
+			h__ = (h__ + 1) / 2;\
+			(LEVELS)[k__].meta.width = w__;\
+			(LEVELS)[k__].meta.height = h__;\
+			(LEVELS)[k__].meta.hblank = (HBLANK);\
+			(LEVELS)[k__].meta.dirty = NULL;\
+		}\
+	} while (0)
+
+
+/* Downsample the rows A and B, with W pixels, to the row O, with N
+ * pixels, by averaging 4 channels in each 2 by 2 block; the last
+ * column is repeated if W is odd */
+#define libslim_pyramid_row_4__(O, A, B, W, N, CH1, CH2, CH3, CH4)\
+	do {\
+		size_t px__, p0__, p1__;\
+		for (px__ = 0; px__ < (N); px__++) {\
+			p0__ = 2 * px__;\
+			p1__ = p0__ + 1 < (W) ? p0__ + 1 : p0__;\
+			(O)[px__].CH1 = ((A)[p0__].CH1 + (A)[p1__].CH1 + (B)[p0__].CH1 + (B)[p1__].CH1) / 4;\
+			(O)[px__].CH2 = ((A)[p0__].CH2 + (A)[p1__].CH2 + (B)[p0__].CH2 + (B)[p1__].CH2) / 4;\
+			(O)[px__].CH3 = ((A)[p0__].CH3 + (A)[p1__].CH3 + (B)[p0__].CH3 + (B)[p1__].CH3) / 4;\
+			(O)[px__].CH4 = ((A)[p0__].CH4 + (A)[p1__].CH4 + (B)[p0__].CH4 + (B)[p1__].CH4) / 4;\
+		}\
+	} while (0)
+
+
+/* Downsample the rows A and B, with W pixels, to the row O, with N
+ * pixels, by averaging 3 channels in each 2 by 2 block; the last
+ * column is repeated if W is odd */
+#define libslim_pyramid_row_3__(O, A, B, W, N, CH1, CH2, CH3)\
+	do {\
+		size_t px__, p0__, p1__;\
+		for (px__ = 0; px__ < (N); px__++) {\
+			p0__ = 2 * px__;\
+			p1__ = p0__ + 1 < (W) ? p0__ + 1 : p0__;\
+			(O)[px__].CH1 = ((A)[p0__].CH1 + (A)[p1__].CH1 + (B)[p0__].CH1 + (B)[p1__].CH1) / 4;\
+			(O)[px__].CH2 = ((A)[p0__].CH2 + (A)[p1__].CH2 + (B)[p0__].CH2 + (B)[p1__].CH2) / 4;\
+			(O)[px__].CH3 = ((A)[p0__].CH3 + (A)[p1__].CH3 + (B)[p0__].CH3 + (B)[p1__].CH3) / 4;\
+		}\
+	} while (0)
+
+
+/* Downsample the rows A and B, with W pixels, to the row O, with N
+ * pixels, by premultiplying 3 channels with the channel ALPHA as
+ * they are read, and averaging them and ALPHA in each 2 by 2
+ * block; the last column is repeated if W is odd */
+#define libslim_pyramid_row_premultiply__(O, A, B, W, N, CH1, CH2, CH3, ALPHA)\
+	do {\
+		size_t px__, p0__, p1__;\
+		for (px__ = 0; px__ < (N); px__++) {\
+			p0__ = 2 * px__;\
+			p1__ = p0__ + 1 < (W) ? p0__ + 1 : p0__;\
+			(O)[px__].CH1 = ((A)[p0__].CH1 * (A)[p0__].ALPHA + (A)[p1__].CH1 * (A)[p1__].ALPHA +\
+			                 (B)[p0__].CH1 * (B)[p0__].ALPHA + (B)[p1__].CH1 * (B)[p1__].ALPHA) / 4;\
+			(O)[px__].CH2 = ((A)[p0__].CH2 * (A)[p0__].ALPHA + (A)[p1__].CH2 * (A)[p1__].ALPHA +\
+			                 (B)[p0__].CH2 * (B)[p0__].ALPHA + (B)[p1__].CH2 * (B)[p1__].ALPHA) / 4;\
+			(O)[px__].CH3 = ((A)[p0__].CH3 * (A)[p0__].ALPHA + (A)[p1__].CH3 * (A)[p1__].ALPHA +\
+			                 (B)[p0__].CH3 * (B)[p0__].ALPHA + (B)[p1__].CH3 * (B)[p1__].ALPHA) / 4;\
+			(O)[px__].ALPHA = ((A)[p0__].ALPHA + (A)[p1__].ALPHA + (B)[p0__].ALPHA + (B)[p1__].ALPHA) / 4;\
+		}\
+	} while (0)
+
+
+/* Like libslim_pyramid_row_premultiply__, but unpremultiply the
+ * 3 channels in O after they have been averaged; where ALPHA
+ * is zero, the channels are set to zero */
+#define libslim_pyramid_row_premultiply_unpremultiply__(O, A, B, W, N, CH1, CH2, CH3, ALPHA)\
+	do {\
+		size_t px__, p0__, p1__;\
+		for (px__ = 0; px__ < (N); px__++) {\
+			p0__ = 2 * px__;\
+			p1__ = p0__ + 1 < (W) ? p0__ + 1 : p0__;\
+			(O)[px__].ALPHA = ((A)[p0__].ALPHA + (A)[p1__].ALPHA + (B)[p0__].ALPHA + (B)[p1__].ALPHA) / 4;\
+			(O)[px__].CH1 = ((A)[p0__].CH1 * (A)[p0__].ALPHA + (A)[p1__].CH1 * (A)[p1__].ALPHA +\
+			                 (B)[p0__].CH1 * (B)[p0__].ALPHA + (B)[p1__].CH1 * (B)[p1__].ALPHA) / 4 /\
+			                ((O)[px__].ALPHA + ((O)[px__].ALPHA == 0));\
+			(O)[px__].CH2 = ((A)[p0__].CH2 * (A)[p0__].ALPHA + (A)[p1__].CH2 * (A)[p1__].ALPHA +\
+			                 (B)[p0__].CH2 * (B)[p0__].ALPHA + (B)[p1__].CH2 * (B)[p1__].ALPHA) / 4 /\
+			                ((O)[px__].ALPHA + ((O)[px__].ALPHA == 0));\
+			(O)[px__].CH3 = ((A)[p0__].CH3 * (A)[p0__].ALPHA + (A)[p1__].CH3 * (A)[p1__].ALPHA +\
+			                 (B)[p0__].CH3 * (B)[p0__].ALPHA + (B)[p1__].CH3 * (B)[p1__].ALPHA) / 4 /\
+			                ((O)[px__].ALPHA + ((O)[px__].ALPHA == 0));\
+		}\
+	} while (0)
+
+
+/* Generate an image pyramid in one pass over the image; each
+ * row is passed down to the next level as soon as it has been
+ * generated, while it is still in cache; ROW0 is used to generate
+ * the first level from the image, and ROW to generate each of the
+ * other levels from the level before it */
+#define libslim_pyramid__(LEVELS, COUNT, IN, ROW0, ROW, ...)\
+	do {\
+		size_t py__, pr__, pk__, ps__;\
+		size_t pn__ = (COUNT);\
+		size_t ih__ = (IN)->meta.height;\
+		size_t is__ = (IN)->meta.width + (IN)->meta.hblank;\
+		if (!pn__)\
+			break;\
+		for (py__ = 0; py__ < (LEVELS)[0].meta.height; py__++) {\
+			ROW0((LEVELS)[0].data + py__ * ((LEVELS)[0].meta.width + (LEVELS)[0].meta.hblank),\
+			     (IN)->data + 2 * py__ * is__,\
+			     (IN)->data + (2 * py__ + 1 < ih__ ? 2 * py__ + 1 : 2 * py__) * is__,\
+			     (IN)->meta.width, (LEVELS)[0].meta.width, __VA_ARGS__);\
+			for (pk__ = 1, pr__ = py__; pk__ < pn__; pk__++, pr__ /= 2) {\
+				if (!(pr__ & 1) && pr__ + 1 != (LEVELS)[pk__ - 1].meta.height)\
+					break;\
+				ps__ = (LEVELS)[pk__ - 1].meta.width + (LEVELS)[pk__ - 1].meta.hblank;\
+				ROW((LEVELS)[pk__].data + pr__ / 2 * ((LEVELS)[pk__].meta.width + (LEVELS)[pk__].meta.hblank),\
+				    (LEVELS)[pk__ - 1].data + (pr__ & ~(size_t)1) * ps__,\
+				    (LEVELS)[pk__ - 1].data + pr__ * ps__,\
+				    (LEVELS)[pk__ - 1].meta.width, (LEVELS)[pk__].meta.width, __VA_ARGS__);\
+			}\
+		}\
+	} while (0)
+
+
+/* Generate an image pyramid, averaging 4 channels; for the alpha
+ * channel to be accounted for, the image must be premultiplied */
+#define libslim_pyramid_4_channels(LEVELS, COUNT, IN, CH1, CH2, CH3, CH4)\
+	libslim_pyramid__(LEVELS, COUNT, IN, libslim_pyramid_row_4__, libslim_pyramid_row_4__,\
+	                  CH1, CH2, CH3, CH4)
+
+
+/* Generate an image pyramid, averaging 3 channels; other channels
+ * are not written, so this is only for images without an alpha
+ * channel, for images with an alpha channel, use
+ * libslim_pyramid_4_channels or libslim_pyramid_3_channels_premultiply */
+#define libslim_pyramid_3_channels(LEVELS, COUNT, IN, CH1, CH2, CH3)\
+	libslim_pyramid__(LEVELS, COUNT, IN, libslim_pyramid_row_3__, libslim_pyramid_row_3__,\
+	                  CH1, CH2, CH3)
+
+
+/* Generate a premultiplied image pyramid from an image that is not
+ * premultiplied, averaging 3 channels and the alpha channel; the
+ * channels are premultiplied as the image is read, so the image
+ * itself is left as is and need not be premultiplied beforehand */
+#define libslim_pyramid_3_channels_premultiply(LEVELS, COUNT, IN, CH1, CH2, CH3)\
+	libslim_pyramid__(LEVELS, COUNT, IN, libslim_pyramid_row_premultiply__,\
+	                  libslim_pyramid_row_4__, CH1, CH2, CH3, a)
+
+
+/* Generate an image pyramid, that is not premultiplied, from an
+ * image that is not premultiplied, averaging 3 channels weighted
+ * by the alpha channel, and the alpha channel; each row is
+ * premultiplied as it is read and unpremultiplied as it is written */
+#define libslim_pyramid_3_channels_premultiply_unpremultiply(LEVELS, COUNT, IN, CH1, CH2, CH3)\
+	libslim_pyramid__(LEVELS, COUNT, IN, libslim_pyramid_row_premultiply_unpremultiply__,\
+	                  libslim_pyramid_row_premultiply_unpremultiply__, CH1, CH2, CH3, a)
+
+
+/* Define a function, for a format, that applies a row operation,
+ * taking an output image, an input image and the 3 colour channels,
+ * to each row of an image */
+#define LIBSLIM_DEFINE_ROWWISE__(NAME, SUFFIX, ROW_OP, CH1, CH2, CH3)\
+	static inline void\
+	NAME(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		struct libslim_image_##SUFFIX o = *out, i = *in;\
+		size_t y;\
+		for (y = 0; y < in->meta.height; y++) {\
+			ROW_OP(&o, &i, CH1, CH2, CH3);\
+			i.data += in->meta.width + in->meta.hblank;\
+			o.data += in->meta.width + out->meta.hblank;\
+		}\
+		out->meta.width = in->meta.width;\
+		out->meta.height = in->meta.height;\
+	}
+
+
+/* Define a function, for a format whose pixels are 4 values of
+ * the type of the vector type VEC with alpha last, that applies
+ * the vector operation VEC_OP to each pixel of an image */
+#define LIBSLIM_DEFINE_VECTORISED__(NAME, SUFFIX, VEC, VEC_OP)\
+	static inline void\
+	NAME(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		struct libslim_pixel_##SUFFIX *o = out->data, *i = in->data;\
+		size_t x, y;\
+		VEC v;\
+		for (y = 0; y < in->meta.height; y++) {\
+			for (x = 0; x < in->meta.width; x++) {\
+				memcpy(&v, &i[x], sizeof(v));\
+				VEC_OP(v);\
+				memcpy(&o[x], &v, sizeof(v));\
+			}\
+			i += in->meta.width + in->meta.hblank;\
+			o += in->meta.width + out->meta.hblank;\
+		}\
+		out->meta.width = in->meta.width;\
+		out->meta.height = in->meta.height;\
+	}
+
+
+/* The functions below are selected, based on the format, by
+ * libslim_premultiply and libslim_unpremultiply; when a kernel
+ * specialised for the layout of the pixels is available, it is
+ * used, otherwise the row macro is applied to each row */
+#if defined(__GNUC__) && !defined(LIBSLIM_NO_VECTORISE)
+
+typedef float libslim_v4f__ __attribute__((__vector_size__(4 * sizeof(float))));
+typedef double libslim_v4d__ __attribute__((__vector_size__(4 * sizeof(double))));
+# if __SIZEOF_LONG_DOUBLE__ == 2 * __SIZEOF_DOUBLE__ || __SIZEOF_LONG_DOUBLE__ == __SIZEOF_DOUBLE__
+typedef double libslim_v4ld__ __attribute__((__vector_size__(4 * sizeof(long double))));
+# else
+typedef long double libslim_v4ld__[4];
+# endif
+
+# define libslim_premultiply_vector__(V)\
+	do {\
+		__typeof__(V) m__ = {(V)[3], (V)[3], (V)[3], 1};\
+		(V) *= m__;\
+	} while (0)
+
+# define libslim_unpremultiply_vector__(V)\
+	do {\
+		__typeof__(V) m__ = {(V)[3], (V)[3], (V)[3], 1};\
+		if ((V)[3])\
+			(V) /= m__;\
+	} while (0)
+
+# define LIBSLIM_DEFINE_SPECIALISED__(NAME, SUFFIX, VEC, VEC_OP, ROW_OP, CH1, CH2, CH3)\
+	LIBSLIM_DEFINE_VECTORISED__(NAME, SUFFIX, VEC, VEC_OP)
+#else
+typedef float libslim_v4f__[4];
+typedef double libslim_v4d__[4];
+typedef long double libslim_v4ld__[4];
+
+# define LIBSLIM_DEFINE_SPECIALISED__(NAME, SUFFIX, VEC, VEC_OP, ROW_OP, CH1, CH2, CH3)\
+	LIBSLIM_DEFINE_ROWWISE__(NAME, SUFFIX, ROW_OP, CH1, CH2, CH3)
+#endif
+
+LIBSLIM_DEFINE_SPECIALISED__(libslim_premultiply_xyza_f__, xyza_f, libslim_v4f__, libslim_premultiply_vector__, libslim_premultiply_3_channels_row, x, y, z)
+LIBSLIM_DEFINE_SPECIALISED__(libslim_premultiply_xyza_d__, xyza_d, libslim_v4d__, libslim_premultiply_vector__, libslim_premultiply_3_channels_row, x, y, z)
+LIBSLIM_DEFINE_ROWWISE__(libslim_premultiply_xyza_ld__, xyza_ld, libslim_premultiply_3_channels_row, x, y, z)
+LIBSLIM_DEFINE_SPECIALISED__(libslim_premultiply_rgba_f__, rgba_f, libslim_v4f__, libslim_premultiply_vector__, libslim_premultiply_3_channels_row, r, g, b)
+LIBSLIM_DEFINE_SPECIALISED__(libslim_premultiply_rgba_d__, rgba_d, libslim_v4d__, libslim_premultiply_vector__, libslim_premultiply_3_channels_row, r, g, b)
+LIBSLIM_DEFINE_ROWWISE__(libslim_premultiply_rgba_ld__, rgba_ld, libslim_premultiply_3_channels_row, r, g, b)
+
+LIBSLIM_DEFINE_SPECIALISED__(libslim_unpremultiply_xyza_f__, xyza_f, libslim_v4f__, libslim_unpremultiply_vector__, libslim_unpremultiply_3_channels_row, x, y, z)
+LIBSLIM_DEFINE_SPECIALISED__(libslim_unpremultiply_xyza_d__, xyza_d, libslim_v4d__, libslim_unpremultiply_vector__, libslim_unpremultiply_3_channels_row, x, y, z)
+LIBSLIM_DEFINE_ROWWISE__(libslim_unpremultiply_xyza_ld__, xyza_ld, libslim_unpremultiply_3_channels_row, x, y, z)
+LIBSLIM_DEFINE_SPECIALISED__(libslim_unpremultiply_rgba_f__, rgba_f, libslim_v4f__, libslim_unpremultiply_vector__, libslim_unpremultiply_3_channels_row, r, g, b)
+LIBSLIM_DEFINE_SPECIALISED__(libslim_unpremultiply_rgba_d__, rgba_d, libslim_v4d__, libslim_unpremultiply_vector__, libslim_unpremultiply_3_channels_row, r, g, b)
+LIBSLIM_DEFINE_ROWWISE__(libslim_unpremultiply_rgba_ld__, rgba_ld, libslim_unpremultiply_3_channels_row, r, g, b)
+
+
+/* Copy a pixel from I to O as a single value of the type UNIT,
+ * which must have the same size as the pixels */
+#define libslim_move_pixel__(UNIT, O, I)\
+	do {\
+		UNIT v__;\
+		memcpy(&v__, (I), sizeof(v__));\
+		memcpy((O), &v__, sizeof(v__));\
+	} while (0)
+
+
+/* Define, for a format, the functions selected by libslim_set_colour_row,
+ * libslim_set_colour, libslim_flop_row, libslim_flop, libslim_flip,
+ * libslim_transpose, libslim_rotate_90, libslim_rotate_180,
+ * libslim_rotate_270 and libslim_crop; the pixels are moved as
+ * values of the type UNIT, a vector type for formats whose pixels
+ * have the size of one, and the pixel type for other formats, and
+ * rows that are not reordered are copied with memcpy */
+#define LIBSLIM_DEFINE_MOVES__(SUFFIX, UNIT)\
+	static inline void\
+	libslim_set_colour_row_##SUFFIX##__(struct libslim_image_##SUFFIX *out, const struct libslim_pixel_##SUFFIX *colour)\
+	{\
+		UNIT c;\
+		size_t x;\
+		memcpy(&c, colour, sizeof(c));\
+		for (x = 0; x < out->meta.width; x++)\
+			memcpy(&out->data[x], &c, sizeof(c));\
+	}\
+	\
+	static inline void\
+	libslim_set_colour_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_pixel_##SUFFIX colour)\
+	{\
+		struct libslim_image_##SUFFIX o = *out;\
+		size_t y;\
+		for (y = 0; y < out->meta.height; y++) {\
+			libslim_set_colour_row_##SUFFIX##__(&o, &colour);\
+			o.data += out->meta.width + out->meta.hblank;\
+		}\
+	}\
+	\
+	static inline void\
+	libslim_move_pixels_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in,\
+	                                 size_t start, ptrdiff_t xstep, ptrdiff_t ystep)\
+	{\
+		struct libslim_pixel_##SUFFIX *o = out->data + start, *i = in->data;\
+		size_t x, y;\
+		for (y = 0; y < in->meta.height; y++) {\
+			for (x = 0; x < in->meta.width; x++)\
+				libslim_move_pixel__(UNIT, &o[(ptrdiff_t)x * xstep], &i[x]);\
+			i += in->meta.width + in->meta.hblank;\
+			o += ystep;\
+		}\
+	}\
+	\
+	static inline void\
+	libslim_flop_row_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		size_t x, n = in->meta.width;\
+		for (x = 0; x < n; x++)\
+			libslim_move_pixel__(UNIT, &out->data[n - 1 - x], &in->data[x]);\
+	}\
+	\
+	static inline void\
+	libslim_flop_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		size_t w = in->meta.width, h = in->meta.height;\
+		out->meta.width = w;\
+		out->meta.height = h;\
+		if (w && h)\
+			libslim_move_pixels_##SUFFIX##__(out, in, w - 1, -1, (ptrdiff_t)(w + out->meta.hblank));\
+	}\
+	\
+	static inline void\
+	libslim_flip_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		struct libslim_pixel_##SUFFIX *o = out->data, *i = in->data;\
+		size_t y, h = in->meta.height;\
+		out->meta.width = in->meta.width;\
+		out->meta.height = h;\
+		for (y = 0; y < h; y++) {\
+			memcpy(&o[(h - 1 - y) * (in->meta.width + out->meta.hblank)], i, in->meta.width * sizeof(*i));\
+			i += in->meta.width + in->meta.hblank;\
+		}\
+	}\
+	\
+	static inline void\
+	libslim_transpose_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		size_t w = in->meta.width, h = in->meta.height;\
+		out->meta.width = h;\
+		out->meta.height = w;\
+		if (w && h)\
+			libslim_move_pixels_##SUFFIX##__(out, in, 0, (ptrdiff_t)(h + out->meta.hblank), 1);\
+	}\
+	\
+	static inline void\
+	libslim_rotate_90_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		size_t w = in->meta.width, h = in->meta.height;\
+		out->meta.width = h;\
+		out->meta.height = w;\
+		if (w && h)\
+			libslim_move_pixels_##SUFFIX##__(out, in, h - 1, (ptrdiff_t)(h + out->meta.hblank), -1);\
+	}\
+	\
+	static inline void\
+	libslim_rotate_180_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		size_t w = in->meta.width, h = in->meta.height;\
+		out->meta.width = w;\
+		out->meta.height = h;\
+		if (w && h)\
+			libslim_move_pixels_##SUFFIX##__(out, in, (h - 1) * (w + out->meta.hblank) + (w - 1),\
+			                                 -1, -(ptrdiff_t)(w + out->meta.hblank));\
+	}\
+	\
+	static inline void\
+	libslim_rotate_270_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		size_t w = in->meta.width, h = in->meta.height;\
+		out->meta.width = h;\
+		out->meta.height = w;\
+		if (w && h)\
+			libslim_move_pixels_##SUFFIX##__(out, in, (w - 1) * (h + out->meta.hblank),\
+			                                 -(ptrdiff_t)(h + out->meta.hblank), 1);\
+	}\
+	\
+	static inline void\
+	libslim_crop_##SUFFIX##__(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in,\
+	                          size_t left, size_t top, size_t width, size_t height)\
+	{\
+		struct libslim_pixel_##SUFFIX *o = out->data;\
+		struct libslim_pixel_##SUFFIX *i = in->data + top * (in->meta.width + in->meta.hblank) + left;\
+		size_t y;\
+		out->meta.width = width;\
+		out->meta.height = height;\
+		for (y = 0; y < height; y++) {\
+			memcpy(o, i, width * sizeof(*i));\
+			i += in->meta.width + in->meta.hblank;\
+			o += width + out->meta.hblank;\
+		}\
+	}
+
+LIBSLIM_DEFINE_MOVES__(xyza_f, libslim_v4f__)
+LIBSLIM_DEFINE_MOVES__(xyza_d, libslim_v4d__)
+LIBSLIM_DEFINE_MOVES__(xyza_ld, libslim_v4ld__)
+LIBSLIM_DEFINE_MOVES__(xyz_f, struct libslim_pixel_xyz_f)
+LIBSLIM_DEFINE_MOVES__(xyz_d, struct libslim_pixel_xyz_d)
+LIBSLIM_DEFINE_MOVES__(xyz_ld, struct libslim_pixel_xyz_ld)
+LIBSLIM_DEFINE_MOVES__(rgba_f, libslim_v4f__)
+LIBSLIM_DEFINE_MOVES__(rgba_d, libslim_v4d__)
+LIBSLIM_DEFINE_MOVES__(rgba_ld, libslim_v4ld__)
+LIBSLIM_DEFINE_MOVES__(rgb_f, struct libslim_pixel_rgb_f)
+LIBSLIM_DEFINE_MOVES__(rgb_d, struct libslim_pixel_rgb_d)
+LIBSLIM_DEFINE_MOVES__(rgb_ld, struct libslim_pixel_rgb_ld)
+
+#if defined(__cplusplus)
+
+# define LIBSLIM_DEFINE_OVERLOAD__(NAME, SUFFIX)\
+	inline void\
+	NAME(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in)\
+	{\
+		NAME##_##SUFFIX##__(out, in);\
+	}
+
+# define LIBSLIM_DEFINE_MOVE_OVERLOADS__(SUFFIX)\
+	inline void\
+	libslim_set_colour_row(struct libslim_image_##SUFFIX *out, const struct libslim_pixel_##SUFFIX *colour)\
+	{\
+		libslim_set_colour_row_##SUFFIX##__(out, colour);\
+	}\
+	\
+	inline void\
+	libslim_set_colour(struct libslim_image_##SUFFIX *out, struct libslim_pixel_##SUFFIX colour)\
+	{\
+		libslim_set_colour_##SUFFIX##__(out, colour);\
+	}\
+	\
+	LIBSLIM_DEFINE_OVERLOAD__(libslim_flop_row, SUFFIX)\
+	LIBSLIM_DEFINE_OVERLOAD__(libslim_flop, SUFFIX)\
+	LIBSLIM_DEFINE_OVERLOAD__(libslim_flip, SUFFIX)\
+	LIBSLIM_DEFINE_OVERLOAD__(libslim_transpose, SUFFIX)\
+	LIBSLIM_DEFINE_OVERLOAD__(libslim_rotate_90, SUFFIX)\
+	LIBSLIM_DEFINE_OVERLOAD__(libslim_rotate_180, SUFFIX)\
+	LIBSLIM_DEFINE_OVERLOAD__(libslim_rotate_270, SUFFIX)\
+	\
+	inline void\
+	libslim_crop(struct libslim_image_##SUFFIX *out, struct libslim_image_##SUFFIX *in,\
+	             size_t left, size_t top, size_t width, size_t height)\
+	{\
+		libslim_crop_##SUFFIX##__(out, in, left, top, width, height);\
+	}
+
+LIBSLIM_DEFINE_OVERLOAD__(libslim_premultiply, xyza_f)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_premultiply, xyza_d)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_premultiply, xyza_ld)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_premultiply, rgba_f)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_premultiply, rgba_d)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_premultiply, rgba_ld)
+
+LIBSLIM_DEFINE_OVERLOAD__(libslim_unpremultiply, xyza_f)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_unpremultiply, xyza_d)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_unpremultiply, xyza_ld)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_unpremultiply, rgba_f)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_unpremultiply, rgba_d)
+LIBSLIM_DEFINE_OVERLOAD__(libslim_unpremultiply, rgba_ld)
+
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(xyza_f)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(xyza_d)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(xyza_ld)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(xyz_f)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(xyz_d)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(xyz_ld)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(rgba_f)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(rgba_d)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(rgba_ld)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(rgb_f)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(rgb_d)
+LIBSLIM_DEFINE_MOVE_OVERLOADS__(rgb_ld)
+
+/* Only the row forms of the generic macros are valid C++, so
+ * only they are available as fallbacks for other formats */
+template <class IMAGE, class PIXEL>
+inline void
+libslim_set_colour_row(IMAGE *out, const PIXEL *colour)
+{
+	libslim_set_colour_row_generic__(out, colour);
+}
+
+template <class IMAGE>
+inline void
+libslim_flop_row(IMAGE *out, IMAGE *in)
+{
+	libslim_flop_row_generic__(out, in);
+}
+
+/* The overloads ignore the channel names, which are accepted so
+ * that calls are the same as in C */
+# define libslim_premultiply(OUT, IN, CH1, CH2, CH3) (libslim_premultiply)((OUT), (IN))
+# define libslim_unpremultiply(OUT, IN, CH1, CH2, CH3) (libslim_unpremultiply)((OUT), (IN))
+
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+
+/* Selected by _Generic for formats without a specialised kernel,
+ * for which LIBSLIM_DISPATCH__ uses the generic macro instead */
+static inline void
+libslim_unspecialised__(const volatile void *out, ...)
+{
+	(void) out;
+}
+
+
+/* Select, based on the format of IMAGE, NAME_<format>__ for the
+ * formats with 4 channels, or libslim_unspecialised__ */
+# define LIBSLIM_SELECT_4__(IMAGE, NAME)\
+	_Generic((IMAGE),\
+	         struct libslim_image_xyza_f *: NAME##_xyza_f__,\
+	         struct libslim_image_xyza_d *: NAME##_xyza_d__,\
+	         struct libslim_image_xyza_ld *: NAME##_xyza_ld__,\
+	         struct libslim_image_rgba_f *: NAME##_rgba_f__,\
+	         struct libslim_image_rgba_d *: NAME##_rgba_d__,\
+	         struct libslim_image_rgba_ld *: NAME##_rgba_ld__,\
+	         default: libslim_unspecialised__)
+
+
+/* Select, based on the format of IMAGE, NAME_<format>__ for all
+ * formats declared in this header, or libslim_unspecialised__ */
+# define LIBSLIM_SELECT__(IMAGE, NAME)\
+	_Generic((IMAGE),\
+	         struct libslim_image_xyza_f *: NAME##_xyza_f__,\
+	         struct libslim_image_xyza_d *: NAME##_xyza_d__,\
+	         struct libslim_image_xyza_ld *: NAME##_xyza_ld__,\
+	         struct libslim_image_xyz_f *: NAME##_xyz_f__,\
+	         struct libslim_image_xyz_d *: NAME##_xyz_d__,\
+	         struct libslim_image_xyz_ld *: NAME##_xyz_ld__,\
+	         struct libslim_image_rgba_f *: NAME##_rgba_f__,\
+	         struct libslim_image_rgba_d *: NAME##_rgba_d__,\
+	         struct libslim_image_rgba_ld *: NAME##_rgba_ld__,\
+	         struct libslim_image_rgb_f *: NAME##_rgb_f__,\
+	         struct libslim_image_rgb_d *: NAME##_rgb_d__,\
+	         struct libslim_image_rgb_ld *: NAME##_rgb_ld__,\
+	         default: libslim_unspecialised__)
+
+
+/* Call SELECTED, a function selected by LIBSLIM_SELECT_4__ or
+ * LIBSLIM_SELECT__, with the parenthesised arguments ARGS, or
+ * if no specialisation was selected, run GENERIC, the call to
+ * the generic macro; the condition is constant */
+# define LIBSLIM_DISPATCH__(SELECTED, ARGS, GENERIC)\
+	do {\
+		if ((void (*)(void))(SELECTED) != (void (*)(void))libslim_unspecialised__)\
+			(SELECTED)ARGS;\
+		else\
+			GENERIC;\
+	} while (0)
+
+
+/* Premultiply the colour channels, CH1, CH2 and CH3, in all pixels
+ * in an image with 4 channels, using a kernel specialised for the
+ * format if there is one, otherwise libslim_premultiply_3_channels */
+# define libslim_premultiply(OUT, IN, CH1, CH2, CH3)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT_4__((IN), libslim_premultiply), ((OUT), (IN)),\
+	                   libslim_premultiply_3_channels((OUT), (IN), CH1, CH2, CH3))
+
+
+/* Unpremultiply the colour channels, CH1, CH2 and CH3, in all pixels
+ * in an image with 4 channels, using a kernel specialised for the
+ * format if there is one, otherwise libslim_unpremultiply_3_channels */
+# define libslim_unpremultiply(OUT, IN, CH1, CH2, CH3)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT_4__((IN), libslim_unpremultiply), ((OUT), (IN)),\
+	                   libslim_unpremultiply_3_channels((OUT), (IN), CH1, CH2, CH3))
+
+
+/* Replace an entire row, of an image, with a single colour,
+ * COLOUR is a pointer to the colour */
+# define libslim_set_colour_row(OUT, COLOUR)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((OUT), libslim_set_colour_row), ((OUT), (COLOUR)),\
+	                   libslim_set_colour_row_generic__((OUT), (COLOUR)))
+
+
+/* Replace an entire image with a single colour */
+# define libslim_set_colour(OUT, COLOUR)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((OUT), libslim_set_colour), ((OUT), (COLOUR)),\
+	                   libslim_set_colour_generic__((OUT), (COLOUR)))
+
+
+/* Horizontally flip a row of an image */
+# define libslim_flop_row(OUT, IN)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((IN), libslim_flop_row), ((OUT), (IN)),\
+	                   libslim_flop_row_generic__((OUT), (IN)))
+
+
+/* Horizontally flip an image */
+# define libslim_flop(OUT, IN)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((IN), libslim_flop), ((OUT), (IN)),\
+	                   libslim_flop_generic__((OUT), (IN)))
+
+
+/* Vertically flip an image */
+# define libslim_flip(OUT, IN)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((IN), libslim_flip), ((OUT), (IN)),\
+	                   libslim_flip_generic__((OUT), (IN)))
+
+
+/* Transpose an image */
+# define libslim_transpose(OUT, IN)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((IN), libslim_transpose), ((OUT), (IN)),\
+	                   libslim_transpose_generic__((OUT), (IN)))
+
+
+/* Rotate an image 90 degrees clockwise */
+# define libslim_rotate_90(OUT, IN)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((IN), libslim_rotate_90), ((OUT), (IN)),\
+	                   libslim_rotate_90_generic__((OUT), (IN)))
+
+
+/* Rotate an image 180 degrees */
+# define libslim_rotate_180(OUT, IN)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((IN), libslim_rotate_180), ((OUT), (IN)),\
+	                   libslim_rotate_180_generic__((OUT), (IN)))
+
+
+/* Rotate an image 270 degrees clockwise */
+# define libslim_rotate_270(OUT, IN)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((IN), libslim_rotate_270), ((OUT), (IN)),\
+	                   libslim_rotate_270_generic__((OUT), (IN)))
+
+
+/* Crop an image */
+# define libslim_crop(OUT, IN, LEFT, TOP, WIDTH, HEIGHT)\
+	LIBSLIM_DISPATCH__(LIBSLIM_SELECT__((IN), libslim_crop), ((OUT), (IN), (LEFT), (TOP), (WIDTH), (HEIGHT)),\
+	                   libslim_crop_generic__((OUT), (IN), (LEFT), (TOP), (WIDTH), (HEIGHT)))
+
+#else
+
+/* Without _Generic, the format cannot be inspected,
+ * so the generic macros are always used */
+# define libslim_premultiply(OUT, IN, CH1, CH2, CH3)\
+	libslim_premultiply_3_channels(OUT, IN, CH1, CH2, CH3)
+# define libslim_unpremultiply(OUT, IN, CH1, CH2, CH3)\
+	libslim_unpremultiply_3_channels(OUT, IN, CH1, CH2, CH3)
+# define libslim_set_colour_row(OUT, COLOUR)\
+	libslim_set_colour_row_generic__(OUT, COLOUR)
+# define libslim_set_colour(OUT, COLOUR)\
+	libslim_set_colour_generic__(OUT, COLOUR)
+# define libslim_flop_row(OUT, IN)\
+	libslim_flop_row_generic__(OUT, IN)
+# define libslim_flop(OUT, IN)\
+	libslim_flop_generic__(OUT, IN)
+# define libslim_flip(OUT, IN)\
+	libslim_flip_generic__(OUT, IN)
+# define libslim_transpose(OUT, IN)\
+	libslim_transpose_generic__(OUT, IN)
+# define libslim_rotate_90(OUT, IN)\
+	libslim_rotate_90_generic__(OUT, IN)
+# define libslim_rotate_180(OUT, IN)\
+	libslim_rotate_180_generic__(OUT, IN)
+# define libslim_rotate_270(OUT, IN)\
+	libslim_rotate_270_generic__(OUT, IN)
+# define libslim_crop(OUT, IN, LEFT, TOP, WIDTH, HEIGHT)\
+	libslim_crop_generic__(OUT, IN, LEFT, TOP, WIDTH, HEIGHT)
+
+#endif
+
+
 #endif